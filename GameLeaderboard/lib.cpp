@@ -2,9 +2,21 @@
 #include <string>
 #include <fstream>
 #include <stdexcept>
+#include <climits>
+#include "../Instrumentation/metrics.h"  // Build with -pthread or -DMETRICS_DISABLED
 
 using namespace std;
 
+// Metrics
+METRICS_HISTOGRAM(addOrUpdateLatency, "leaderboard_add_or_update_player", "addOrUpdatePlayer latency.");
+METRICS_HISTOGRAM(sortLatency, "leaderboard_sort_all_players", "sortAllPlayers latency.");
+METRICS_HISTOGRAM(saveLatency, "leaderboard_save", "saveLeaderboard latency.");
+METRICS_COUNTER(playersAdded, "leaderboard_players_added", "New players added.");
+METRICS_COUNTER(playersUpdated, "leaderboard_players_updated", "Existing players whose score was updated.");
+METRICS_COUNTER(playersRejected, "leaderboard_players_rejected", "Players not added because the board was full.");
+METRICS_COUNTER(invalidScores, "leaderboard_invalid_scores", "Scores rejected as out of range.");
+METRICS_COUNTER(fileErrors, "leaderboard_file_errors", "Leaderboard files that could not be opened.");
+
 // Structure representing a player in the leaderboard
 struct Player {
     string name;   // Player's name
@@ -30,6 +42,7 @@ private:
 
     // Sorts the linked list of all players in descending order of scores
     void sortAllPlayers() {
+        METRICS_TIME(sortLatency);
         if (!head || !head->next) return;
 
         bool swapped;
@@ -100,7 +113,9 @@ public:
 
     // Adds a new player or updates an existing player's score
     void addOrUpdatePlayer(const string& name, int score) {
+        METRICS_TIME(addOrUpdateLatency);
         if (score < 0 || score > 100) {
+            METRICS_INC(invalidScores);
             throw invalid_argument("Score must be between 0 and 100.");
         }
 
@@ -109,6 +124,7 @@ public:
         while (current) {
             if (current->name == name) {
                 current->score = score; // Update score
+                METRICS_INC(playersUpdated);
                 return;
             }
             current = current->next;
@@ -116,6 +132,7 @@ public:
 
         // Add a new player if there's space
         if (playerCount >= MAX_PLAYERS) {
+            METRICS_INC(playersRejected);
             cout << "Maximum players (" << MAX_PLAYERS << ") reached. Cannot add more players." << endl;
             return;
         }
@@ -124,6 +141,7 @@ public:
         newPlayer->next = head; // Add to the beginning of the list
         head = newPlayer;
         playerCount++;
+        METRICS_INC(playersAdded);
     }
 
     // Displays the top 10 players
@@ -160,6 +178,7 @@ public:
 
     // Saves the leaderboard to a file with ranks
     void saveLeaderboard() {
+        METRICS_TIME(saveLatency);
         ofstream file("leaderboard.txt");
         if (file.is_open()) {
             file << "-----------------------------------------------\n";
@@ -177,12 +196,14 @@ public:
             file.close();
         }
         else {
+            METRICS_INC(fileErrors);
             cout << "Error opening file!" << endl;
         }
     }
 };
 
 int main() {
+    METRICS_START_EXPORTER();
     Leaderboard lb;
     string playerName;
     int playerScore, choice;
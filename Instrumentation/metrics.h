@@ -0,0 +1,481 @@
+/**
+Shared metrics for ParkingManagement and GameLeaderboard (header only).
+
+Counters and latency histograms are kept per thread: each thread owns a
+shard and is its only writer, so recording is a relaxed load + store with
+no locks and no read-modify-write. The exporter sums the shards.
+Histograms are HDR-style log-linear (64 sub-buckets per power of two,
+under 1.6% relative error, 1 ns to ~18 min) and export as Prometheus
+summaries with p50/p90/p99/p99.9.
+
+  METRICS_COUNTER(var, "name", "help");    define at namespace scope
+  METRICS_HISTOGRAM(var, "name", "help");  define at namespace scope
+  METRICS_INC(var); METRICS_ADD(var, n);
+  METRICS_TIME(var);                       times the enclosing scope
+  METRICS_START_EXPORTER();                call once at program start
+
+The exporter reads its settings from the environment:
+  METRICS_FILE      path rewritten in Prometheus text format
+  METRICS_INTERVAL  seconds between file writes (default 10)
+  METRICS_PORT      serve GET /metrics on 127.0.0.1:port (not on Windows)
+The file is written one last time at exit.
+
+Compile with -DMETRICS_DISABLED to remove every metric at compile time;
+otherwise link with -pthread.
+**/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifdef METRICS_DISABLED
+
+#define METRICS_COUNTER(var, name, help)
+#define METRICS_HISTOGRAM(var, name, help)
+#define METRICS_INC(var) ((void)0)
+#define METRICS_ADD(var, n) ((void)0)
+#define METRICS_TIME(var) ((void)0)
+#define METRICS_START_EXPORTER() ((void)0)
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace metrics {
+
+const int MAX_COUNTERS = 64;
+const int MAX_HISTOGRAMS = 32;
+
+// Log-linear bucketing: values below 128 get their own bucket, then each
+// power of two from 2^7 to 2^40 is split into 64 sub-buckets.
+const int SUB_BITS = 6;
+const int LINEAR_BUCKETS = 2 << SUB_BITS;
+const int MAX_EXPONENT = 40;
+const int BUCKETS =
+    LINEAR_BUCKETS + (MAX_EXPONENT - SUB_BITS - 1) * (1 << SUB_BITS);
+
+inline int bucketIndex(uint64_t value) {
+  if (value < uint64_t(LINEAR_BUCKETS)) {
+    return int(value);
+  }
+  int exponent = 63;
+  while (!(value >> exponent)) {
+    --exponent;
+  }
+  if (exponent >= MAX_EXPONENT) {
+    return BUCKETS - 1; // Clamp anything slower than ~18 minutes
+  }
+  int shift = exponent - SUB_BITS;
+  int sub = int(value >> shift) - (1 << SUB_BITS);
+  return LINEAR_BUCKETS + (exponent - SUB_BITS - 1) * (1 << SUB_BITS) + sub;
+}
+
+// Midpoint of the values that map to a bucket
+inline double bucketValue(int index) {
+  if (index < LINEAR_BUCKETS) {
+    return index;
+  }
+  int k = index - LINEAR_BUCKETS;
+  int shift = k / (1 << SUB_BITS) + 1;
+  uint64_t sub = (1 << SUB_BITS) + k % (1 << SUB_BITS);
+  uint64_t low = sub << shift;
+  uint64_t high = ((sub + 1) << shift) - 1;
+  return (double(low) + double(high)) / 2;
+}
+
+// One thread's slice of every metric. Only the owning thread writes it.
+struct Shard {
+  std::atomic<uint64_t> counters[MAX_COUNTERS];
+  std::atomic<std::atomic<uint64_t> *> buckets[MAX_HISTOGRAMS];
+  std::atomic<uint64_t> sums[MAX_HISTOGRAMS]; // Nanoseconds
+
+  Shard() {
+    for (int i = 0; i < MAX_COUNTERS; ++i) {
+      counters[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < MAX_HISTOGRAMS; ++i) {
+      buckets[i].store(NULL, std::memory_order_relaxed);
+      sums[i].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct Registry {
+  std::mutex lock;
+  std::vector<std::string> counterNames, counterHelp;
+  std::vector<std::string> histogramNames, histogramHelp;
+  std::vector<Shard *> shards; // Never freed, so totals survive thread exit
+};
+
+inline Registry &registry() {
+  static Registry *instance = new Registry; // Outlives static destructors
+  return *instance;
+}
+
+inline Shard &localShard() {
+  thread_local Shard *shard = NULL;
+  if (shard == NULL) {
+    shard = new Shard;
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.shards.push_back(shard);
+  }
+  return *shard;
+}
+
+inline void bump(std::atomic<uint64_t> &cell, uint64_t n) {
+  cell.store(cell.load(std::memory_order_relaxed) + n,
+             std::memory_order_relaxed);
+}
+
+struct Counter {
+  int id;
+
+  Counter(const char *name, const char *help) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    id = int(reg.counterNames.size());
+    if (id >= MAX_COUNTERS) {
+      std::fprintf(stderr, "metrics: too many counters (%s)\n", name);
+      std::abort();
+    }
+    reg.counterNames.push_back(name);
+    reg.counterHelp.push_back(help);
+  }
+
+  void add(uint64_t n) { bump(localShard().counters[id], n); }
+};
+
+struct Histogram {
+  int id;
+
+  Histogram(const char *name, const char *help) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    id = int(reg.histogramNames.size());
+    if (id >= MAX_HISTOGRAMS) {
+      std::fprintf(stderr, "metrics: too many histograms (%s)\n", name);
+      std::abort();
+    }
+    reg.histogramNames.push_back(name);
+    reg.histogramHelp.push_back(help);
+  }
+
+  void record(uint64_t nanos) {
+    Shard &shard = localShard();
+    std::atomic<uint64_t> *buckets =
+        shard.buckets[id].load(std::memory_order_relaxed);
+    if (buckets == NULL) {
+      buckets = new std::atomic<uint64_t>[BUCKETS];
+      for (int i = 0; i < BUCKETS; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+      }
+      shard.buckets[id].store(buckets, std::memory_order_release);
+    }
+    bump(buckets[bucketIndex(nanos)], 1);
+    bump(shard.sums[id], nanos);
+  }
+};
+
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &histogram)
+      : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    std::chrono::nanoseconds elapsed =
+        std::chrono::steady_clock::now() - start;
+    histogram.record(uint64_t(elapsed.count()));
+  }
+
+private:
+  Histogram &histogram;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Current totals in Prometheus text exposition format
+inline std::string renderPrometheus() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  std::ostringstream out;
+
+  for (size_t c = 0; c < reg.counterNames.size(); ++c) {
+    uint64_t total = 0;
+    for (size_t s = 0; s < reg.shards.size(); ++s) {
+      total += reg.shards[s]->counters[c].load(std::memory_order_relaxed);
+    }
+    const std::string &name = reg.counterNames[c];
+    out << "# HELP " << name << "_total " << reg.counterHelp[c] << "\n";
+    out << "# TYPE " << name << "_total counter\n";
+    out << name << "_total " << total << "\n";
+  }
+
+  const double quantiles[4] = {0.5, 0.9, 0.99, 0.999};
+  std::vector<uint64_t> merged(BUCKETS);
+  for (size_t h = 0; h < reg.histogramNames.size(); ++h) {
+    std::fill(merged.begin(), merged.end(), 0);
+    uint64_t count = 0, sum = 0;
+    for (size_t s = 0; s < reg.shards.size(); ++s) {
+      std::atomic<uint64_t> *buckets =
+          reg.shards[s]->buckets[h].load(std::memory_order_acquire);
+      if (buckets == NULL) {
+        continue;
+      }
+      for (int b = 0; b < BUCKETS; ++b) {
+        uint64_t n = buckets[b].load(std::memory_order_relaxed);
+        merged[b] += n;
+        count += n;
+      }
+      sum += reg.shards[s]->sums[h].load(std::memory_order_relaxed);
+    }
+
+    const std::string &name = reg.histogramNames[h];
+    out << "# HELP " << name << "_seconds " << reg.histogramHelp[h] << "\n";
+    out << "# TYPE " << name << "_seconds summary\n";
+    uint64_t seen = 0;
+    int b = 0;
+    for (int q = 0; q < 4; ++q) {
+      double value = 0;
+      if (count > 0) {
+        uint64_t rank = uint64_t(quantiles[q] * double(count - 1)) + 1;
+        while (seen + merged[b] < rank) {
+          seen += merged[b++];
+        }
+        value = bucketValue(b) / 1e9;
+      }
+      out << name << "_seconds{quantile=\"" << quantiles[q] << "\"} "
+          << value << "\n";
+    }
+    out << name << "_seconds_sum " << double(sum) / 1e9 << "\n";
+    out << name << "_seconds_count " << count << "\n";
+  }
+  return out.str();
+}
+
+// Writes to a temporary file and renames it so readers never see half
+inline bool writeFile(const std::string &path) {
+  std::string temp = path + ".tmp";
+  FILE *file = std::fopen(temp.c_str(), "w");
+  if (file == NULL) {
+    return false;
+  }
+  std::string text = renderPrometheus();
+  bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+  ok = std::fclose(file) == 0 && ok;
+  return ok && std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+class Exporter {
+public:
+  Exporter() : stopping(false), listenFd(-1) {
+    const char *file = std::getenv("METRICS_FILE");
+    const char *interval = std::getenv("METRICS_INTERVAL");
+    const char *port = std::getenv("METRICS_PORT");
+    filePath = file != NULL ? file : "";
+    intervalMs = interval != NULL ? std::atoi(interval) * 1000 : 10000;
+    if (intervalMs <= 0) {
+      intervalMs = 10000;
+    }
+    if (port != NULL) {
+      int portNum = parsePort(port);
+      if (portNum > 0) {
+        openListener(portNum);
+      } else {
+        std::fprintf(stderr, "metrics: invalid METRICS_PORT %s (want 1-65535)\n",
+                     port);
+      }
+    }
+    if (!filePath.empty() || listenFd >= 0) {
+      worker = std::thread(&Exporter::run, this);
+    }
+  }
+
+  ~Exporter() {
+    stopping.store(true);
+    if (worker.joinable()) {
+      worker.join();
+    }
+    if (!filePath.empty()) {
+      writeFile(filePath); // Final totals
+    }
+#ifndef _WIN32
+    if (listenFd >= 0) {
+      close(listenFd);
+    }
+#endif
+  }
+
+private:
+  std::atomic<bool> stopping;
+  std::string filePath;
+  int intervalMs;
+  int listenFd;
+  std::thread worker;
+
+  // Port number in 1-65535, or -1
+  static int parsePort(const char *text) {
+    std::string digits(text);
+    if (digits.empty() || digits.size() > 5 ||
+        digits.find_first_not_of("0123456789") != std::string::npos) {
+      return -1;
+    }
+    int port = std::atoi(digits.c_str());
+    return port >= 1 && port <= 65535 ? port : -1;
+  }
+
+  void run() {
+    typedef std::chrono::steady_clock Clock;
+    const int SLICE_MS = 200; // How quickly stop and scrapes are noticed
+    Clock::time_point nextWrite =
+        Clock::now() + std::chrono::milliseconds(intervalMs);
+    while (!stopping.load()) {
+      int waitMs = SLICE_MS;
+      if (!filePath.empty()) {
+        long long untilWrite =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                nextWrite - Clock::now())
+                .count();
+        waitMs = (int)std::max(0LL, std::min((long long)SLICE_MS, untilWrite));
+      }
+      waitForScrape(waitMs);
+      Clock::time_point now = Clock::now();
+      if (!filePath.empty() && now >= nextWrite) {
+        if (!writeFile(filePath)) {
+          std::fprintf(stderr, "metrics: unable to write %s\n",
+                       filePath.c_str());
+        }
+        // Skip missed intervals rather than writing in a burst
+        nextWrite += std::chrono::milliseconds(intervalMs);
+        if (nextWrite <= now) {
+          nextWrite = now + std::chrono::milliseconds(intervalMs);
+        }
+      }
+    }
+  }
+
+#ifndef _WIN32
+  void openListener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 16) < 0) {
+      std::fprintf(stderr, "metrics: unable to listen on port %d\n", port);
+      close(fd);
+      return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    listenFd = fd;
+  }
+
+  // Answers one scrape if it arrives within timeoutMs, otherwise sleeps.
+  // A scrape gets at most SCRAPE_TIMEOUT_MS, so a stalled client cannot
+  // hold up the periodic file write or shutdown.
+  void waitForScrape(int timeoutMs) {
+    if (listenFd < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+      return;
+    }
+    pollfd pfd = {listenFd, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+      return;
+    }
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+      return;
+    }
+    const int SCRAPE_TIMEOUT_MS = 1000;
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(SCRAPE_TIMEOUT_MS);
+    timeval timeout = {0, 100 * 1000}; // Bounds each recv/send call
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Any request gets the metrics, so wait only for its first bytes
+    char request[1024];
+    pollfd cfd = {fd, POLLIN, 0};
+    if (poll(&cfd, 1, SCRAPE_TIMEOUT_MS) <= 0 ||
+        recv(fd, request, sizeof(request), 0) <= 0) {
+      close(fd);
+      return;
+    }
+    std::string body = renderPrometheus();
+    std::ostringstream response;
+    response << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n\r\n"
+             << body;
+    std::string text = response.str();
+    size_t sent = 0;
+    while (sent < text.size() && std::chrono::steady_clock::now() < deadline) {
+      ssize_t n =
+          send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 &&
+          (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        continue; // Timed out this call; the deadline bounds the total
+      }
+      if (n <= 0) {
+        break;
+      }
+      sent += n;
+    }
+    close(fd);
+  }
+#else
+  void openListener(int port) {
+    std::fprintf(stderr, "metrics: METRICS_PORT is not supported here\n");
+  }
+
+  void waitForScrape(int timeoutMs) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+  }
+#endif
+};
+
+inline void startExporter() {
+  static Exporter exporter; // Stopped, with a final write, at exit
+}
+
+} // namespace metrics
+
+#define METRICS_COUNTER(var, name, help) metrics::Counter var(name, help)
+#define METRICS_HISTOGRAM(var, name, help) metrics::Histogram var(name, help)
+#define METRICS_INC(var) (var).add(1)
+#define METRICS_ADD(var, n) (var).add(n)
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_TIME(var)                                                      \
+  metrics::ScopedTimer METRICS_CONCAT(metricsTimer_, __LINE__)(var)
+#define METRICS_START_EXPORTER() metrics::startExporter()
+
+#endif // METRICS_DISABLED
+
+#endif // METRICS_H
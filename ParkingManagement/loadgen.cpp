@@ -0,0 +1,175 @@
+/**
+Load generator for the parking server (main --serve).
+
+Usage: loadgen [port | /unix/socket/path] [batches] [batchSize] [depth]
+Sends `batches` frames of `batchSize` requests each, keeping up to `depth`
+frames in flight, then prints requests/sec and per-batch latency
+percentiles. Each batch repeats park -> search -> retrieve -> status for
+batchSize / 4 plates, so batchSize must be a multiple of 4; every park is
+matched by a retrieve and the lot never stays full.
+**/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+int connectTo(const string &endpoint) {
+  bool isPort = !endpoint.empty() &&
+                endpoint.find_first_not_of("0123456789") == string::npos;
+  int fd;
+  if (isPort) {
+    if (endpoint.size() > 5 || stoi(endpoint) < 1 || stoi(endpoint) > 65535) {
+      return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(stoi(endpoint));
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+      return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  } else {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, endpoint.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+      return -1;
+    }
+  }
+  return fd;
+}
+
+bool sendAll(int fd, const string &buf) {
+  size_t sent = 0;
+  while (sent < buf.size()) {
+    ssize_t n = send(fd, buf.data() + sent, buf.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+bool recvAll(int fd, char *buf, size_t len) {
+  size_t got = 0;
+  while (got < len) {
+    ssize_t n = recv(fd, buf + got, len - got, 0);
+    if (n <= 0) {
+      return false;
+    }
+    got += n;
+  }
+  return true;
+}
+
+string buildBatch(long batchNo, int batchSize) {
+  const unsigned char ops[4] = {1, 3, 2, 4}; // park, search, retrieve, status
+  string payload;
+  payload += char(batchSize);
+  for (int k = 0; k < batchSize; ++k) {
+    string plate = "LG" + to_string(batchNo) + "-" + to_string(k / 4);
+    payload += char(ops[k % 4]);
+    payload += char(plate.size());
+    payload += plate;
+  }
+  string frame;
+  for (int i = 0; i < 4; ++i) {
+    frame += char((payload.size() >> (8 * i)) & 0xff);
+  }
+  return frame + payload;
+}
+
+// Reads one response frame and checks it answers batchSize requests
+bool readResponse(int fd, int batchSize) {
+  unsigned char header[4];
+  if (!recvAll(fd, (char *)header, 4)) {
+    return false;
+  }
+  size_t len = header[0] | (header[1] << 8) | (header[2] << 16) |
+               (size_t(header[3]) << 24);
+  vector<char> payload(len);
+  if (len == 0 || !recvAll(fd, payload.data(), len)) {
+    return false;
+  }
+  return (unsigned char)payload[0] == batchSize;
+}
+
+double percentile(const vector<double> &sorted, double p) {
+  size_t idx = size_t(p * (sorted.size() - 1) + 0.5);
+  return sorted[idx];
+}
+
+int main(int argc, char *argv[]) {
+  string endpoint = argc > 1 ? argv[1] : "5050";
+  long batches = argc > 2 ? stol(argv[2]) : 100000;
+  int batchSize = argc > 3 ? stoi(argv[3]) : 16;
+  int depth = argc > 4 ? stoi(argv[4]) : 8;
+  if (batches < 1 || batchSize < 4 || batchSize > 252 || batchSize % 4 != 0 ||
+      depth < 1) {
+    cerr << "Usage: loadgen [port | path] [batches] "
+            "[batchSize: multiple of 4, 4-252] [depth]\n";
+    return 1;
+  }
+
+  int fd = connectTo(endpoint);
+  if (fd < 0) {
+    cerr << "Unable to connect to " << endpoint << "\n";
+    return 1;
+  }
+
+  vector<double> latencies; // Microseconds per batch round trip
+  latencies.reserve(batches);
+  deque<Clock::time_point> inFlight;
+  long sent = 0;
+  Clock::time_point start = Clock::now();
+  while (latencies.size() < size_t(batches)) {
+    while (sent < batches && inFlight.size() < size_t(depth)) {
+      if (!sendAll(fd, buildBatch(sent, batchSize))) {
+        cerr << "Send failed after " << sent << " batches\n";
+        return 1;
+      }
+      inFlight.push_back(Clock::now());
+      ++sent;
+    }
+    if (!readResponse(fd, batchSize)) {
+      cerr << "Bad or missing response after " << latencies.size()
+           << " batches\n";
+      return 1;
+    }
+    chrono::duration<double, micro> rtt = Clock::now() - inFlight.front();
+    inFlight.pop_front();
+    latencies.push_back(rtt.count());
+  }
+  chrono::duration<double> elapsed = Clock::now() - start;
+  close(fd);
+
+  sort(latencies.begin(), latencies.end());
+  double requests = double(batches) * batchSize;
+  cout << "Batches: " << batches << " x " << batchSize
+       << " requests, depth " << depth << "\n";
+  cout << "Elapsed: " << elapsed.count() << " s\n";
+  cout << "Throughput: " << requests / elapsed.count() << " requests/sec\n";
+  cout << "Batch latency (us): p50 " << percentile(latencies, 0.50)
+       << "  p99 " << percentile(latencies, 0.99) << "  p99.9 "
+       << percentile(latencies, 0.999) << "  max " << latencies.back()
+       << "\n";
+  return 0;
+}
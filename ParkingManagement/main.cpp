@@ -4,10 +4,51 @@ Overview of code (Data Structure main use):
 LinkedList: for vehicle logs,  also for searching             - done
 Queue: if parking is full, vehicle goes to a waiting queue.   - done
 Stack: to track recently vacated spots                        - done
+AVL tree: per-slot reservation index, keyed by start time     - done
+Min-heap: no-show reservation expiry, keyed by deadline       - done
+
+Server mode (main --serve [port | /unix/socket/path]):
+epoll-driven, non-blocking sockets; each connection may pipeline several
+frames, each frame carries a batch of requests. All integers little-endian.
+  request frame : u32 payloadLen | u8 count | count x (u8 op | u8 len | plate)
+  response frame: u32 payloadLen | u8 count | count x (u8 status | u8 len | data)
+  op     : 1 park, 2 retrieve, 3 search, 4 status (plate ignored)
+  status : 0 ok, 1 queued, 2 not found, 3 bad request
+  data   : slot number for park/retrieve/search,
+           u16 available | u16 occupied | u16 waiting for status
+SIGINT or SIGTERM stops the server cleanly (files flushed, Unix socket
+removed, final metrics written).
+A malformed frame is not run at all; the connection is closed once the
+responses to the frames before it have been written.
+See loadgen.cpp for a load-generating client.
+
+Metrics: see ../Instrumentation/metrics.h (build with -pthread, or with
+-DMETRICS_DISABLED to compile them out).
 **/
 
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include "../Instrumentation/metrics.h"
+#ifdef __linux__
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 // Linked list for vehicle logs
@@ -38,14 +79,89 @@ struct StackNode {
 };
 StackNode *stackTop = NULL;
 
+// AVL tree of reservations for one slot. Reservations on a slot never
+// overlap, so ordering by start also orders by end.
+struct Reservation {
+  string plateNum;
+  long start; // Minutes since the epoch
+  long end;   // Exclusive
+  bool claimed;
+  int height;
+  Reservation *left;
+  Reservation *right;
+};
+Reservation *reservationTree[rows][cols];
+long claimedStart[rows][cols]; // Start of the reservation in use, or -1
+
+// Min-heap of no-show deadlines
+struct ExpiryEntry {
+  long deadline;
+  long start;
+  long end;
+  int row;
+  int col;
+};
+ExpiryEntry *expiryHeap = NULL;
+int heapSize = 0;
+int heapCapacity = 0;
+const int GRACE_MINUTES = 15; // No-shows lose the slot after this long
+const int EARLY_MINUTES = 30; // Holders may claim their slot this early
+
+// Metrics
+METRICS_HISTOGRAM(parkLatency, "parking_park_vehicle", "ParkVehicle latency.");
+METRICS_HISTOGRAM(retrieveLatency, "parking_retrieve_vehicle",
+                  "RetrieveVehicle latency.");
+METRICS_HISTOGRAM(logWriteLatency, "parking_write_log",
+                  "parking_log.txt write latency, direct or batched.");
+METRICS_HISTOGRAM(parkedWriteLatency, "parking_write_parked_vehicles",
+                  "writeCurrentParkedVehiclesToFile latency.");
+METRICS_HISTOGRAM(reservationWriteLatency, "parking_write_reservations",
+                  "writeReservationsToFile latency.");
+METRICS_HISTOGRAM(flushLatency, "parking_flush_pending_writes",
+                  "flushPendingWrites latency.");
+METRICS_HISTOGRAM(batchLatency, "parking_server_batch",
+                  "Server time to answer one request batch.");
+METRICS_COUNTER(parkedCount, "parking_vehicles_parked", "Vehicles parked.");
+METRICS_COUNTER(queuedCount, "parking_vehicles_queued",
+                "Vehicles sent to the waiting queue.");
+METRICS_COUNTER(retrievedCount, "parking_vehicles_retrieved",
+                "Vehicles retrieved.");
+METRICS_COUNTER(notFoundCount, "parking_retrieve_not_found",
+                "Retrievals of plates not in the lot.");
+METRICS_COUNTER(expiredCount, "parking_reservations_expired",
+                "Reservations dropped as no-shows.");
+METRICS_COUNTER(fileErrorCount, "parking_file_errors",
+                "Files that could not be opened.");
+METRICS_COUNTER(requestCount, "parking_server_requests",
+                "Requests answered by the server.");
+METRICS_COUNTER(badFrameCount, "parking_server_bad_frames",
+                "Malformed frames; each closes its connection.");
+METRICS_COUNTER(connectionCount, "parking_server_connections",
+                "Connections accepted by the server.");
+METRICS_COUNTER(acceptErrorCount, "parking_server_accept_errors",
+                "accept failures, e.g. out of file descriptors.");
+
+// Batch mode: file writes are held back until flushPendingWrites()
+bool deferWrites = false;
+bool parkedDirty = false;
+bool reservationsDirty = false;
+string pendingLog;
+
 // Function prototypes
 void initializeParkingLot();
-void ParkVehicle(string plateNum);
-void RetrieveVehicle(string plateNum);
+string ParkVehicle(string plateNum);
+string RetrieveVehicle(string plateNum);
 void DisplayAvailable();
 void DisplayQueue();
 void DisplaySlotStatus();
 void SearchLicensePlate(string plateNum);
+string findSlot(string plateNum);
+int countAvailable();
+int countOccupied();
+int countWaiting();
+bool slotUsable(int row, int col, long now);
+string parkAt(int row, int col, string plateNum);
+void promoteWaiting();
 void DisplayStack();
 bool isFull();
 bool isEmpty();
@@ -55,6 +171,30 @@ void removeLog(string plateNum);
 void writeLogToFile(const string &entry);
 void writeCurrentParkedVehiclesToFile();
 void loadCurrentParkedVehiclesFromFile();
+void flushPendingWrites();
+void writeReservationsToFile();
+void loadReservationsFromFile();
+void ReserveSlot(string plateNum, string slot, string date, string from,
+                 string to);
+void DisplayReservations();
+long currentMinute();
+long parseClock(const string &date, const string &hhmm);
+string formatClock(long minute);
+string slotName(int row, int col);
+bool parseSlot(const string &slotNumber, int &row, int &col);
+bool validPlate(const string &plateNum);
+int nodeHeight(Reservation *node);
+Reservation *insertReservation(Reservation *node, Reservation *res);
+Reservation *eraseReservation(Reservation *node, long start);
+Reservation *findReservation(Reservation *node, long start);
+Reservation *findOverlap(Reservation *node, long start, long end);
+Reservation *findNext(Reservation *node, long now);
+Reservation *findHeld(Reservation *node, const string &plateNum, long now,
+                      long horizon);
+bool findFreeSlot(long start, long end, int &row, int &col);
+void pushExpiry(ExpiryEntry entry);
+ExpiryEntry popExpiry();
+void expireReservations(long now);
 string custom_to_string(int num);
 string custom_string_concat(const string &str1, const string &str2);
 void pop();
@@ -63,12 +203,17 @@ bool isStackEmpty();
 string topStack();
 void enqueue(string plateNum);
 void dequeue();
+int runServer(const string &endpoint);
 
-int main() {
+int main(int argc, char *argv[]) {
   int choice;
   string plateNum;
 
+  METRICS_START_EXPORTER();
   initializeParkingLot();
+  if (argc > 1 && string(argv[1]) == "--serve") {
+    return runServer(argc > 2 ? argv[2] : "5050");
+  }
   while (true) {
     cout << "\nParking Lot Management System\n";
     cout << "1. Park a Vehicle\n";
@@ -78,7 +223,9 @@ int main() {
     cout << "5. Display Slot Status\n";
     cout << "6. Search for a License Plate\n";
     cout << "7. Display Recently Vacated Spots\n";
-    cout << "8. Exit\n";
+    cout << "8. Reserve a Slot\n";
+    cout << "9. Display Reservations\n";
+    cout << "10. Exit\n";
     cout << "Enter your choice: ";
     cin >> choice;
 
@@ -120,7 +267,25 @@ int main() {
     case 7:
       DisplayStack();
       break;
-    case 8:
+    case 8: {
+      string slot, date, from, to;
+      cout << "Enter plate number: ";
+      cin >> plateNum;
+      cout << "Enter slot (e.g. B2) or ANY: ";
+      cin >> slot;
+      cout << "Enter date (YYYY-MM-DD) or NEXT: ";
+      cin >> date;
+      cout << "Enter start time (HH:MM): ";
+      cin >> from;
+      cout << "Enter end time (HH:MM): ";
+      cin >> to;
+      ReserveSlot(plateNum, slot, date, from, to);
+      break;
+    }
+    case 9:
+      DisplayReservations();
+      break;
+    case 10:
       cout << "Exiting...\n";
       return 0;
     default:
@@ -139,38 +304,92 @@ void initializeParkingLot() {
   for (int i = 0; i < rows; ++i) {
     for (int j = 0; j < cols; ++j) {
       ParkingArray[i][j] = "EMPTY";
+      reservationTree[i][j] = NULL;
+      claimedStart[i][j] = -1;
     }
   }
   loadCurrentParkedVehiclesFromFile();
+  loadReservationsFromFile();
 }
 
-void ParkVehicle(string plateNum) {
+// Returns the slot number, or "" if the vehicle was queued
+string ParkVehicle(string plateNum) {
+  METRICS_TIME(parkLatency);
+  long now = currentMinute();
+  expireReservations(now);
+
+  // A vehicle arriving during, or up to EARLY_MINUTES before, its own
+  // reservation takes the reserved slot, unless an earlier reservation on
+  // that slot by someone else is still owed it
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      Reservation *res =
+          findHeld(reservationTree[i][j], plateNum, now, now + EARLY_MINUTES);
+      if (res == NULL) {
+        continue;
+      }
+      if (ParkingArray[i][j] == "EMPTY" &&
+          findNext(reservationTree[i][j], now) == res) {
+        res->claimed = true;
+        claimedStart[i][j] = res->start;
+        writeReservationsToFile();
+        return parkAt(i, j, plateNum);
+      }
+      if (res->start <= now) {
+        // Slot still held by an overstaying vehicle: release the
+        // reservation and park the holder like a walk-in
+        reservationTree[i][j] = eraseReservation(reservationTree[i][j],
+                                                 res->start);
+        writeReservationsToFile();
+      }
+    }
+  }
+
   if (isFull()) {
     cout << "Parking lot is full. Adding vehicle to the waiting queue.\n";
     enqueue(plateNum);
-  } else {
-    for (int i = 0; i < rows; ++i) {
-      for (int j = 0; j < cols; ++j) {
-        if (ParkingArray[i][j] == "EMPTY") {
-          ParkingArray[i][j] = plateNum; // Park the vehicle
-          string slotNumber =
-              custom_string_concat(string(1, 'A' + i), custom_to_string(j + 1));
-          logVehicle(plateNum, slotNumber); // Log the vehicle
-          writeLogToFile(custom_string_concat(
-              "Parked: ",
-              custom_string_concat(
-                  plateNum, custom_string_concat(" at slot ", slotNumber))));
-          writeCurrentParkedVehiclesToFile();
-          cout << "Vehicle with plate number " << plateNum
-               << " is parked at slot " << slotNumber << ".\n";
-          return;
-        }
+    METRICS_INC(queuedCount);
+    return "";
+  }
+  // Walk-ins take the free slot whose next reservation is furthest away,
+  // so slots about to be claimed stay free for their holders
+  int bestRow = -1, bestCol = -1;
+  long bestNext = -1;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      if (!slotUsable(i, j, now)) {
+        continue;
+      }
+      Reservation *next = findNext(reservationTree[i][j], now);
+      long nextStart = next == NULL ? LONG_MAX : next->start;
+      if (nextStart > bestNext) {
+        bestRow = i;
+        bestCol = j;
+        bestNext = nextStart;
       }
     }
   }
+  return parkAt(bestRow, bestCol, plateNum);
+}
+
+string parkAt(int row, int col, string plateNum) {
+  ParkingArray[row][col] = plateNum; // Park the vehicle
+  string slotNumber = slotName(row, col);
+  logVehicle(plateNum, slotNumber); // Log the vehicle
+  writeLogToFile(custom_string_concat(
+      "Parked: ",
+      custom_string_concat(plateNum,
+                           custom_string_concat(" at slot ", slotNumber))));
+  writeCurrentParkedVehiclesToFile();
+  METRICS_INC(parkedCount);
+  cout << "Vehicle with plate number " << plateNum << " is parked at slot "
+       << slotNumber << ".\n";
+  return slotNumber;
 }
 
-void RetrieveVehicle(string plateNum) {
+// Returns the vacated slot number, or "" if the vehicle was not found
+string RetrieveVehicle(string plateNum) {
+  METRICS_TIME(retrieveLatency);
   for (int i = 0; i < rows; ++i) {
     for (int j = 0; j < cols; ++j) {
       if (ParkingArray[i][j] == plateNum) {
@@ -186,27 +405,43 @@ void RetrieveVehicle(string plateNum) {
         cout << "Vehicle with plate number " << plateNum
              << " retrieved from slot " << slotNumber << ".\n";
 
+        METRICS_INC(retrievedCount);
+
         // Push vacated slot to stack
         push(slotNumber);
 
-        if (!isEmpty()) {
-          dequeue();
+        // A claimed reservation ends when its vehicle leaves
+        if (claimedStart[i][j] != -1) {
+          reservationTree[i][j] =
+              eraseReservation(reservationTree[i][j], claimedStart[i][j]);
+          claimedStart[i][j] = -1;
+          writeReservationsToFile();
         }
-        return;
+
+        expireReservations(currentMinute());
+        promoteWaiting();
+        return slotNumber;
       }
     }
   }
+  METRICS_INC(notFoundCount);
   cout << "Vehicle with plate number " << plateNum
        << " not found in the parking lot.\n";
+  return "";
 }
 
 void DisplayAvailable() {
+  long now = currentMinute();
+  expireReservations(now);
   cout << "\nParking Lot Status:\n";
   for (int i = 0; i < rows; ++i) {
     for (int j = 0; j < cols; ++j) {
       string slotNumber =
           custom_string_concat(string(1, 'A' + i), custom_to_string(j + 1));
-      if (ParkingArray[i][j] == "EMPTY") {
+      Reservation *res = findOverlap(reservationTree[i][j], now, now + 1);
+      if (ParkingArray[i][j] == "EMPTY" && res != NULL) {
+        cout << slotNumber << " [RESERVED " << res->plateNum << "] ";
+      } else if (ParkingArray[i][j] == "EMPTY") {
         cout << slotNumber << " [EMPTY] ";
       } else {
         cout << slotNumber << " [" << ParkingArray[i][j] << "] ";
@@ -232,33 +467,75 @@ void DisplayQueue() {
 }
 
 void DisplaySlotStatus() {
-  int available = 0, occupied = 0;
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
-      if (ParkingArray[i][j] == "EMPTY") {
-        ++available;
-      } else {
-        ++occupied;
-      }
-    }
-  }
+  expireReservations(currentMinute());
+  int available = countAvailable();
+  int occupied = countOccupied();
   cout << "\nParking Slot Status:\n";
   cout << "Available slots: " << available << endl;
   cout << "Occupied slots: " << occupied << endl;
+  cout << "Reserved slots: " << rows * cols - available - occupied << endl;
 }
 
 void SearchLicensePlate(string plateNum) {
-  VehicleLog *current = logHead;
+  string slotNumber = findSlot(plateNum);
+  if (!slotNumber.empty()) {
+    cout << "License plate " << plateNum << " is parked at slot " << slotNumber
+         << ".\n";
+    return;
+  }
+  cout << "License plate " << plateNum << " is not found in the parking lot.\n";
+}
 
+// Returns the slot a plate is parked at, or "" if it is not parked
+string findSlot(string plateNum) {
+  VehicleLog *current = logHead;
   while (current != NULL) {
     if (current->plateNum == plateNum) {
-      cout << "License plate " << plateNum << " is parked at slot "
-           << current->slotNumber << ".\n";
-      return;
+      return current->slotNumber;
     }
     current = current->next;
   }
-  cout << "License plate " << plateNum << " is not found in the parking lot.\n";
+  return "";
+}
+
+// Slots a walk-in could take right now
+int countAvailable() {
+  long now = currentMinute();
+  int available = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      if (slotUsable(i, j, now)) {
+        ++available;
+      }
+    }
+  }
+  return available;
+}
+
+int countOccupied() {
+  int occupied = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      if (ParkingArray[i][j] != "EMPTY") {
+        ++occupied;
+      }
+    }
+  }
+  return occupied;
+}
+
+// Empty and not held by a reservation covering `now`
+bool slotUsable(int row, int col, long now) {
+  return ParkingArray[row][col] == "EMPTY" &&
+         findOverlap(reservationTree[row][col], now, now + 1) == NULL;
+}
+
+int countWaiting() {
+  int count = 0;
+  for (Node *current = front; current != NULL; current = current->next) {
+    ++count;
+  }
+  return count;
 }
 
 void DisplayStack() {
@@ -308,10 +585,12 @@ void dequeue() {
   ParkVehicle(plateNum);
 }
 
+// Full for walk-ins: reserved slots do not count as free
 bool isFull() {
+  long now = currentMinute();
   for (int i = 0; i < rows; ++i) {
     for (int j = 0; j < cols; ++j) {
-      if (ParkingArray[i][j] == "EMPTY") {
+      if (slotUsable(i, j, now)) {
         return false;
       }
     }
@@ -319,6 +598,13 @@ bool isFull() {
   return true;
 }
 
+// Parks waiting vehicles while there are slots they may use
+void promoteWaiting() {
+  while (!isEmpty() && !isFull()) {
+    dequeue();
+  }
+}
+
 bool isEmpty() { return front == NULL; }
 //--------------------------------------------------------------------------
 
@@ -353,16 +639,28 @@ void removeLog(string plateNum) {
 }
 //--------------------------File handling--------------------------------
 void writeLogToFile(const string &entry) {
+  if (deferWrites) {
+    pendingLog += entry;
+    pendingLog += '\n';
+    return;
+  }
+  METRICS_TIME(logWriteLatency); // Only real writes, not deferred appends
   ofstream logFile("parking_log.txt", ios::app);
   if (logFile.is_open()) {
     logFile << entry << endl;
     logFile.close();
   } else {
-    cout << "Unable to open log file.\n";
+    METRICS_INC(fileErrorCount);
+    cerr << "Unable to open log file.\n";
   }
 }
 
 void writeCurrentParkedVehiclesToFile() {
+  if (deferWrites) {
+    parkedDirty = true; // Rewritten once per batch
+    return;
+  }
+  METRICS_TIME(parkedWriteLatency);
   ofstream currentParkedFile("current_parked_vehicles.txt");
   if (currentParkedFile.is_open()) {
     for (int i = 0; i < rows; ++i) {
@@ -377,7 +675,8 @@ void writeCurrentParkedVehiclesToFile() {
     }
     currentParkedFile.close();
   } else {
-    cout << "Unable to open current parked vehicles file.\n";
+    METRICS_INC(fileErrorCount);
+    cerr << "Unable to open current parked vehicles file.\n";
   }
 }
 
@@ -390,10 +689,13 @@ void loadCurrentParkedVehiclesFromFile() {
       if (atPos != string::npos) {
         string plateNum = line.substr(0, atPos);    // Extract plate number
         string slotNumber = line.substr(atPos + 9); // Extract slot number
-        int row = slotNumber[0] - 'A'; // Convert row letter to index
-        int col =
-            stoi(slotNumber.substr(1)) - 1; // Convert column number to index
-        ParkingArray[row][col] = plateNum;  // Updates the parking array
+        int row, col;
+        if (!validPlate(plateNum) || !parseSlot(slotNumber, row, col) ||
+            ParkingArray[row][col] != "EMPTY") {
+          cerr << "Skipping bad parked vehicle entry: " << line << "\n";
+          continue;
+        }
+        ParkingArray[row][col] = plateNum; // Updates the parking array
         logVehicle(plateNum, slotNumber);
       }
     }
@@ -403,6 +705,533 @@ void loadCurrentParkedVehiclesFromFile() {
   }
 }
 
+// Writes out everything held back while deferWrites was set
+void flushPendingWrites() {
+  if (pendingLog.empty() && !parkedDirty && !reservationsDirty) {
+    return;
+  }
+  METRICS_TIME(flushLatency);
+  bool wasDeferred = deferWrites;
+  deferWrites = false;
+  if (!pendingLog.empty()) {
+    METRICS_TIME(logWriteLatency);
+    ofstream logFile("parking_log.txt", ios::app);
+    if (logFile.is_open()) {
+      logFile << pendingLog;
+      logFile.close();
+    } else {
+      METRICS_INC(fileErrorCount);
+      cerr << "Unable to open log file.\n";
+    }
+    pendingLog.clear();
+  }
+  if (parkedDirty) {
+    writeCurrentParkedVehiclesToFile();
+    parkedDirty = false;
+  }
+  if (reservationsDirty) {
+    writeReservationsToFile();
+    reservationsDirty = false;
+  }
+  deferWrites = wasDeferred;
+}
+
+void writeReservationsToFile() {
+  if (deferWrites) {
+    reservationsDirty = true;
+    return;
+  }
+  METRICS_TIME(reservationWriteLatency);
+  ofstream reservationFile("reservations.txt");
+  if (!reservationFile.is_open()) {
+    METRICS_INC(fileErrorCount);
+    cerr << "Unable to open reservations file.\n";
+    return;
+  }
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      // Iterative in-order walk keeps the file sorted by start time
+      Reservation *stack[64];
+      int depth = 0;
+      Reservation *current = reservationTree[i][j];
+      while (current != NULL || depth > 0) {
+        while (current != NULL) {
+          stack[depth++] = current;
+          current = current->left;
+        }
+        current = stack[--depth];
+        reservationFile << current->plateNum << " " << slotName(i, j) << " "
+                        << current->start << " " << current->end << " "
+                        << current->claimed << "\n";
+        current = current->right;
+      }
+    }
+  }
+  reservationFile.close();
+}
+
+void loadReservationsFromFile() {
+  ifstream reservationFile("reservations.txt");
+  if (!reservationFile.is_open()) {
+    return; // No reservations yet
+  }
+  string line;
+  while (getline(reservationFile, line)) {
+    istringstream fields(line);
+    string plateNum, slotNumber, extra;
+    long start, end;
+    bool claimed;
+    int row, col;
+    if (!(fields >> plateNum >> slotNumber >> start >> end >> claimed) ||
+        fields >> extra || !validPlate(plateNum) ||
+        !parseSlot(slotNumber, row, col) || end <= start ||
+        findOverlap(reservationTree[row][col], start, end) != NULL) {
+      if (!line.empty()) {
+        cerr << "Skipping bad reservation entry: " << line << "\n";
+      }
+      continue;
+    }
+    // Only trust "claimed" if the holder is really parked in the slot;
+    // otherwise nothing would ever release it, so let it expire instead
+    claimed = claimed && ParkingArray[row][col] == plateNum &&
+              claimedStart[row][col] == -1;
+    Reservation *res = new Reservation;
+    res->plateNum = plateNum;
+    res->start = start;
+    res->end = end;
+    res->claimed = claimed;
+    reservationTree[row][col] =
+        insertReservation(reservationTree[row][col], res);
+    if (claimed) {
+      claimedStart[row][col] = start;
+    } else {
+      ExpiryEntry entry = {min(start + GRACE_MINUTES, end), start, end, row,
+                           col};
+      pushExpiry(entry);
+    }
+  }
+  reservationFile.close();
+}
+
+//--------------------------Reservations--------------------------------
+// `date` is YYYY-MM-DD, or NEXT for the next time the window comes round
+// (today, or tomorrow if it has already ended today). An end time at or
+// before the start time means the reservation runs overnight.
+void ReserveSlot(string plateNum, string slot, string date, string from,
+                 string to) {
+  long now = currentMinute();
+  expireReservations(now);
+  bool next = date == "NEXT" || date == "next";
+  long start = parseClock(next ? "" : date, from);
+  long end = parseClock(next ? "" : date, to);
+  if (start < 0 || end < 0) {
+    cout << "Invalid date or time. Use YYYY-MM-DD (or NEXT) and HH:MM.\n";
+    return;
+  }
+  if (end <= start) {
+    end += 24 * 60; // Overnight reservation
+  }
+  if (next && end <= now) {
+    start += 24 * 60; // Already over today, so book tomorrow
+    end += 24 * 60;
+  }
+  if (end <= now) {
+    cout << "That time has already passed.\n";
+    return;
+  }
+  if (start < now) {
+    start = now;
+  }
+
+  int row, col;
+  if (slot == "ANY" || slot == "any") {
+    if (!findFreeSlot(start, end, row, col)) {
+      cout << "No slot is free from " << formatClock(start) << " to "
+           << formatClock(end) << ".\n";
+      return;
+    }
+  } else if (!parseSlot(slot, row, col)) {
+    cout << "Invalid slot " << slot << ".\n";
+    return;
+  } else if (findOverlap(reservationTree[row][col], start, end) != NULL ||
+             (start <= now && ParkingArray[row][col] != "EMPTY")) {
+    cout << "Slot " << slot << " is not free from " << formatClock(start)
+         << " to " << formatClock(end) << ".\n";
+    return;
+  }
+
+  Reservation *res = new Reservation;
+  res->plateNum = plateNum;
+  res->start = start;
+  res->end = end;
+  res->claimed = false;
+  reservationTree[row][col] = insertReservation(reservationTree[row][col], res);
+  ExpiryEntry entry = {min(start + GRACE_MINUTES, end), start, end, row, col};
+  pushExpiry(entry);
+
+  string slotNumber = slotName(row, col);
+  string logEntry = custom_string_concat("Reserved: ", plateNum);
+  logEntry = custom_string_concat(
+      logEntry, custom_string_concat(" at slot ", slotNumber));
+  logEntry = custom_string_concat(
+      logEntry, custom_string_concat(" from ", formatClock(start)));
+  logEntry = custom_string_concat(
+      logEntry, custom_string_concat(" to ", formatClock(end)));
+  writeLogToFile(logEntry);
+  writeReservationsToFile();
+  cout << "Slot " << slotNumber << " reserved for " << plateNum << " from "
+       << formatClock(start) << " to " << formatClock(end) << ".\n";
+}
+
+void DisplayReservations() {
+  expireReservations(currentMinute());
+  cout << "\nReservations:\n";
+  int count = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      Reservation *stack[64]; // AVL height stays far below this
+      int depth = 0;
+      Reservation *current = reservationTree[i][j];
+      while (current != NULL || depth > 0) {
+        while (current != NULL) {
+          stack[depth++] = current;
+          current = current->left;
+        }
+        current = stack[--depth];
+        cout << ++count << ". " << slotName(i, j) << " " << current->plateNum
+             << " " << formatClock(current->start) << " to "
+             << formatClock(current->end)
+             << (current->claimed ? " (parked)" : "") << "\n";
+        current = current->right;
+      }
+    }
+  }
+  if (count == 0) {
+    cout << "No reservations.\n";
+  }
+}
+
+// First slot with no reservation overlapping [start, end); a slot that is
+// occupied now only qualifies if the reservation starts later
+bool findFreeSlot(long start, long end, int &row, int &col) {
+  long now = currentMinute();
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      if (findOverlap(reservationTree[i][j], start, end) == NULL &&
+          (start > now || ParkingArray[i][j] == "EMPTY")) {
+        row = i;
+        col = j;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Drops reservations whose holder has not arrived within the grace period
+void expireReservations(long now) {
+  bool expired = false;
+  while (heapSize > 0 && expiryHeap[0].deadline <= now) {
+    ExpiryEntry entry = popExpiry();
+    Reservation *res =
+        findReservation(reservationTree[entry.row][entry.col], entry.start);
+    if (res == NULL || res->claimed || res->end != entry.end) {
+      continue; // Already claimed or replaced
+    }
+    if (ParkingArray[entry.row][entry.col] == res->plateNum) {
+      // Holder was already parked in the slot before it was claimed
+      res->claimed = true;
+      claimedStart[entry.row][entry.col] = res->start;
+      writeReservationsToFile();
+      continue;
+    }
+    writeLogToFile(custom_string_concat(
+        "Expired: ",
+        custom_string_concat(
+            res->plateNum,
+            custom_string_concat(" at slot ",
+                                 slotName(entry.row, entry.col)))));
+    reservationTree[entry.row][entry.col] =
+        eraseReservation(reservationTree[entry.row][entry.col], entry.start);
+    METRICS_INC(expiredCount);
+    expired = true;
+  }
+  if (expired) {
+    writeReservationsToFile();
+    promoteWaiting();
+  }
+}
+
+long currentMinute() { return long(time(NULL) / 60); }
+
+// "HH:MM" on `date` (YYYY-MM-DD, or today if empty), as minutes since the
+// epoch; -1 if malformed
+long parseClock(const string &date, const string &hhmm) {
+  if (hhmm.size() != 5 || hhmm[2] != ':' || !isdigit(hhmm[0]) ||
+      !isdigit(hhmm[1]) || !isdigit(hhmm[3]) || !isdigit(hhmm[4])) {
+    return -1;
+  }
+  int hours = (hhmm[0] - '0') * 10 + (hhmm[1] - '0');
+  int minutes = (hhmm[3] - '0') * 10 + (hhmm[4] - '0');
+  if (hours > 23 || minutes > 59) {
+    return -1;
+  }
+  time_t now = time(NULL);
+  tm local = *localtime(&now);
+  if (!date.empty()) {
+    int year, month, day;
+    char extra;
+    if (sscanf(date.c_str(), "%4d-%2d-%2d%c", &year, &month, &day, &extra) !=
+            3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+      return -1;
+    }
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+  }
+  local.tm_hour = hours;
+  local.tm_min = minutes;
+  local.tm_sec = 0;
+  local.tm_isdst = -1; // Let mktime work out daylight saving for that date
+  int wantDay = local.tm_mday;
+  time_t when = mktime(&local);
+  if (when == time_t(-1) || local.tm_mday != wantDay) {
+    return -1; // e.g. 2026-02-30
+  }
+  return long(when / 60);
+}
+
+string formatClock(long minute) {
+  time_t t = time_t(minute) * 60;
+  tm local = *localtime(&t);
+  char buf[17];
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", &local);
+  return buf;
+}
+
+string slotName(int row, int col) {
+  return custom_string_concat(string(1, 'A' + row), custom_to_string(col + 1));
+}
+
+bool parseSlot(const string &slotNumber, int &row, int &col) {
+  if (slotNumber.size() < 2 || slotNumber.size() > 4) {
+    return false;
+  }
+  for (size_t k = 1; k < slotNumber.size(); ++k) {
+    if (!isdigit(slotNumber[k])) {
+      return false;
+    }
+  }
+  row = toupper(slotNumber[0]) - 'A';
+  col = atoi(slotNumber.c_str() + 1) - 1;
+  return row >= 0 && row < rows && col >= 0 && col < cols;
+}
+
+// Plates are written to space-separated files, so like plates read with
+// `cin >>` they must be non-empty with no whitespace or control characters
+// (which also rules out " at slot ")
+bool validPlate(const string &plateNum) {
+  if (plateNum.empty()) {
+    return false;
+  }
+  for (size_t k = 0; k < plateNum.size(); ++k) {
+    unsigned char c = plateNum[k];
+    if (c <= ' ' || c == 0x7f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//---------------------------AVL Tree-----------------------------
+int nodeHeight(Reservation *node) { return node == NULL ? 0 : node->height; }
+
+void updateHeight(Reservation *node) {
+  node->height = 1 + max(nodeHeight(node->left), nodeHeight(node->right));
+}
+
+Reservation *rotateRight(Reservation *node) {
+  Reservation *pivot = node->left;
+  node->left = pivot->right;
+  pivot->right = node;
+  updateHeight(node);
+  updateHeight(pivot);
+  return pivot;
+}
+
+Reservation *rotateLeft(Reservation *node) {
+  Reservation *pivot = node->right;
+  node->right = pivot->left;
+  pivot->left = node;
+  updateHeight(node);
+  updateHeight(pivot);
+  return pivot;
+}
+
+Reservation *rebalance(Reservation *node) {
+  updateHeight(node);
+  int balance = nodeHeight(node->left) - nodeHeight(node->right);
+  if (balance > 1) {
+    if (nodeHeight(node->left->left) < nodeHeight(node->left->right)) {
+      node->left = rotateLeft(node->left);
+    }
+    return rotateRight(node);
+  }
+  if (balance < -1) {
+    if (nodeHeight(node->right->right) < nodeHeight(node->right->left)) {
+      node->right = rotateRight(node->right);
+    }
+    return rotateLeft(node);
+  }
+  return node;
+}
+
+Reservation *insertReservation(Reservation *node, Reservation *res) {
+  if (node == NULL) {
+    res->height = 1;
+    res->left = res->right = NULL;
+    return res;
+  }
+  if (res->start < node->start) {
+    node->left = insertReservation(node->left, res);
+  } else {
+    node->right = insertReservation(node->right, res);
+  }
+  return rebalance(node);
+}
+
+Reservation *eraseReservation(Reservation *node, long start) {
+  if (node == NULL) {
+    return NULL;
+  }
+  if (start < node->start) {
+    node->left = eraseReservation(node->left, start);
+  } else if (start > node->start) {
+    node->right = eraseReservation(node->right, start);
+  } else {
+    if (node->left == NULL || node->right == NULL) {
+      Reservation *child = node->left != NULL ? node->left : node->right;
+      delete node;
+      return child;
+    }
+    // Two children: take over the successor's contents
+    Reservation *successor = node->right;
+    while (successor->left != NULL) {
+      successor = successor->left;
+    }
+    node->plateNum = successor->plateNum;
+    node->start = successor->start;
+    node->end = successor->end;
+    node->claimed = successor->claimed;
+    node->right = eraseReservation(node->right, successor->start);
+  }
+  return rebalance(node);
+}
+
+Reservation *findReservation(Reservation *node, long start) {
+  while (node != NULL && node->start != start) {
+    node = start < node->start ? node->left : node->right;
+  }
+  return node;
+}
+
+// Reservation overlapping [start, end), or NULL. Only the latest reservation
+// starting before `end` can overlap, since a slot's reservations are disjoint.
+Reservation *findOverlap(Reservation *node, long start, long end) {
+  Reservation *candidate = NULL;
+  while (node != NULL) {
+    if (node->start < end) {
+      candidate = node;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  if (candidate != NULL && candidate->end > start) {
+    return candidate;
+  }
+  return NULL;
+}
+
+// Earliest reservation still running or yet to start at `now`, or NULL
+Reservation *findNext(Reservation *node, long now) {
+  Reservation *candidate = NULL;
+  while (node != NULL) {
+    if (node->end > now) {
+      candidate = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return candidate;
+}
+
+// Earliest unclaimed reservation of `plateNum` still running at `now` or
+// starting before `horizon`, or NULL. Only subtrees that can hold such a
+// reservation are visited.
+Reservation *findHeld(Reservation *node, const string &plateNum, long now,
+                      long horizon) {
+  if (node == NULL) {
+    return NULL;
+  }
+  if (node->end > now) {
+    Reservation *res = findHeld(node->left, plateNum, now, horizon);
+    if (res != NULL) {
+      return res;
+    }
+    if (node->start < horizon && !node->claimed &&
+        node->plateNum == plateNum) {
+      return node;
+    }
+  }
+  if (node->start < horizon) {
+    return findHeld(node->right, plateNum, now, horizon);
+  }
+  return NULL;
+}
+
+//---------------------------Min-Heap-----------------------------
+void pushExpiry(ExpiryEntry entry) {
+  if (heapSize == heapCapacity) {
+    int newCapacity = heapCapacity == 0 ? 16 : heapCapacity * 2;
+    ExpiryEntry *grown = new ExpiryEntry[newCapacity];
+    for (int k = 0; k < heapSize; ++k) {
+      grown[k] = expiryHeap[k];
+    }
+    delete[] expiryHeap;
+    expiryHeap = grown;
+    heapCapacity = newCapacity;
+  }
+  int k = heapSize++;
+  while (k > 0 && expiryHeap[(k - 1) / 2].deadline > entry.deadline) {
+    expiryHeap[k] = expiryHeap[(k - 1) / 2];
+    k = (k - 1) / 2;
+  }
+  expiryHeap[k] = entry;
+}
+
+ExpiryEntry popExpiry() {
+  ExpiryEntry top = expiryHeap[0];
+  ExpiryEntry last = expiryHeap[--heapSize];
+  int k = 0;
+  while (2 * k + 1 < heapSize) {
+    int child = 2 * k + 1;
+    if (child + 1 < heapSize &&
+        expiryHeap[child + 1].deadline < expiryHeap[child].deadline) {
+      ++child;
+    }
+    if (last.deadline <= expiryHeap[child].deadline) {
+      break;
+    }
+    expiryHeap[k] = expiryHeap[child];
+    k = child;
+  }
+  expiryHeap[k] = last;
+  return top;
+}
+
 //-------------------------------String--------------------------------------
 string custom_to_string(int num) { // to_string replacement
   string result = "";
@@ -464,3 +1293,460 @@ void systemClear() {
         system("clear"); // Clear screen on Unix/Linux/MacOS
     #endif
 }
+
+
+//---------------------------Server-----------------------------
+#ifdef __linux__
+const unsigned char OP_PARK = 1;
+const unsigned char OP_RETRIEVE = 2;
+const unsigned char OP_SEARCH = 3;
+const unsigned char OP_STATUS = 4;
+
+const unsigned char ST_OK = 0;
+const unsigned char ST_QUEUED = 1;
+const unsigned char ST_NOT_FOUND = 2;
+const unsigned char ST_BAD_REQUEST = 3;
+
+const size_t MAX_FRAME = 64 * 1024; // Larger frames close the connection
+// Backpressure: stop reading and running frames for a connection once this
+// much output is waiting for the peer, and read at most READ_BUDGET bytes
+// per wakeup so one busy client cannot starve the rest
+const size_t OUT_HIGH_WATER = 1024 * 1024;
+const size_t READ_BUDGET = 64 * 1024;
+
+struct Connection {
+  int fd;
+  string in;     // Bytes received but not yet parsed
+  string out;    // Responses, written from outPos onwards
+  size_t outPos;
+  unsigned interest; // Current epoll event mask
+  bool closing;      // Close once the remaining responses are written
+};
+
+size_t pendingOutput(const Connection &conn) {
+  return conn.out.size() - conn.outPos;
+}
+
+void putU16(string &buf, unsigned v) {
+  buf += char(v & 0xff);
+  buf += char((v >> 8) & 0xff);
+}
+
+void putU32(string &buf, size_t v) {
+  for (int i = 0; i < 4; ++i) {
+    buf += char((v >> (8 * i)) & 0xff);
+  }
+}
+
+size_t getU32(const string &buf, size_t pos) {
+  size_t v = 0;
+  for (int i = 0; i < 4; ++i) {
+    v |= size_t((unsigned char)buf[pos + i]) << (8 * i);
+  }
+  return v;
+}
+
+void putResult(string &buf, unsigned char status, const string &data) {
+  buf += char(status);
+  buf += char(data.size());
+  buf += data;
+}
+
+void handleRequest(unsigned char op, const string &plateNum, string &resp) {
+  string slotNumber;
+  if (op != OP_STATUS && !validPlate(plateNum)) {
+    putResult(resp, ST_BAD_REQUEST, "");
+    return;
+  }
+  switch (op) {
+  case OP_PARK:
+    slotNumber = ParkVehicle(plateNum);
+    putResult(resp, slotNumber.empty() ? ST_QUEUED : ST_OK, slotNumber);
+    return;
+  case OP_RETRIEVE:
+    slotNumber = RetrieveVehicle(plateNum);
+    putResult(resp, slotNumber.empty() ? ST_NOT_FOUND : ST_OK, slotNumber);
+    return;
+  case OP_SEARCH:
+    slotNumber = findSlot(plateNum);
+    putResult(resp, slotNumber.empty() ? ST_NOT_FOUND : ST_OK, slotNumber);
+    return;
+  case OP_STATUS: {
+    string counts;
+    putU16(counts, countAvailable());
+    putU16(counts, countOccupied());
+    putU16(counts, countWaiting());
+    putResult(resp, ST_OK, counts);
+    return;
+  }
+  default:
+    putResult(resp, ST_BAD_REQUEST, "");
+  }
+}
+
+// True if the payload holds exactly `count` well-formed requests
+bool validBatch(const string &in, size_t pos, size_t len) {
+  size_t end = pos + len;
+  if (len < 1) {
+    return false;
+  }
+  int count = (unsigned char)in[pos++];
+  for (int k = 0; k < count; ++k) {
+    if (end - pos < 2) {
+      return false;
+    }
+    size_t plateLen = (unsigned char)in[pos + 1];
+    pos += 2;
+    if (end - pos < plateLen) {
+      return false;
+    }
+    pos += plateLen;
+  }
+  return pos == end;
+}
+
+// Runs one batch payload; returns false, changing nothing, if it is
+// malformed
+bool handleBatch(const string &in, size_t pos, size_t len, string &out) {
+  if (!validBatch(in, pos, len)) {
+    return false;
+  }
+  METRICS_TIME(batchLatency);
+  int count = (unsigned char)in[pos++];
+  string resp;
+  resp += char(count);
+  for (int k = 0; k < count; ++k) {
+    unsigned char op = in[pos];
+    size_t plateLen = (unsigned char)in[pos + 1];
+    handleRequest(op, in.substr(pos + 2, plateLen), resp);
+    pos += 2 + plateLen;
+  }
+  putU32(out, resp.size());
+  out += resp;
+  METRICS_ADD(requestCount, count);
+  return true;
+}
+
+// Runs complete frames in conn.in until the output backlog reaches
+// OUT_HIGH_WATER; returns false on a protocol error, after answering the
+// frames before it
+bool processInput(Connection &conn) {
+  size_t pos = 0;
+  bool ok = true;
+  while (conn.in.size() - pos >= 4 && pendingOutput(conn) < OUT_HIGH_WATER) {
+    size_t len = getU32(conn.in, pos);
+    if (len > MAX_FRAME) {
+      ok = false;
+      break;
+    }
+    if (conn.in.size() - pos - 4 < len) {
+      break; // Wait for the rest of the frame
+    }
+    if (!handleBatch(conn.in, pos + 4, len, conn.out)) {
+      ok = false;
+      break;
+    }
+    pos += 4 + len;
+  }
+  if (!ok) {
+    METRICS_INC(badFrameCount);
+    pos = conn.in.size(); // Nothing after a bad frame is run
+  }
+  conn.in.erase(0, pos);
+  flushPendingWrites(); // One file write per read, however many batches
+  return ok;
+}
+
+// Writes as much of conn.out as the socket accepts; false on error
+bool flushOutput(Connection &conn) {
+  bool ok = true;
+  while (pendingOutput(conn) > 0) {
+    ssize_t n = send(conn.fd, conn.out.data() + conn.outPos,
+                     pendingOutput(conn), MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ok = errno == EAGAIN || errno == EWOULDBLOCK;
+      break;
+    }
+    conn.outPos += n;
+  }
+  // Drop the written prefix once it is at least half the buffer, so
+  // compaction stays linear in the bytes sent
+  if (conn.outPos * 2 >= conn.out.size()) {
+    conn.out.erase(0, conn.outPos);
+    conn.outPos = 0;
+  }
+  return ok;
+}
+
+// Re-arms epoll for what the connection can do next: read while the
+// backlog is under OUT_HIGH_WATER, write while anything is pending
+void updateInterest(int epfd, Connection &conn) {
+  unsigned interest = 0;
+  if (!conn.closing && pendingOutput(conn) < OUT_HIGH_WATER) {
+    interest |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (pendingOutput(conn) > 0) {
+    interest |= EPOLLOUT;
+  }
+  if (interest != conn.interest) {
+    epoll_event ev;
+    ev.events = interest;
+    ev.data.ptr = &conn;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &ev);
+    conn.interest = interest;
+  }
+}
+
+void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Port number binds 127.0.0.1, anything else is a Unix socket path
+int openListener(const string &endpoint) {
+  bool isPort = !endpoint.empty() &&
+                endpoint.find_first_not_of("0123456789") == string::npos;
+  int fd;
+  if (isPort) {
+    if (endpoint.size() > 5 || stoi(endpoint) < 1 || stoi(endpoint) > 65535) {
+      errno = EINVAL; // Port out of range
+      return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(stoi(endpoint));
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  } else {
+    sockaddr_un addr;
+    if (endpoint.size() >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, endpoint.c_str());
+    unlink(endpoint.c_str()); // Remove a stale socket from a previous run
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  }
+  if (listen(fd, SOMAXCONN) < 0) {
+    close(fd);
+    return -1;
+  }
+  setNonBlocking(fd);
+  return fd;
+}
+
+// Self-pipe: the handler may run on any thread (e.g. the metrics
+// exporter), so it wakes epoll through a pipe rather than relying on EINTR
+int stopPipe[2] = {-1, -1};
+char stopMarker; // Its address tags the pipe's epoll events
+
+void requestStop(int) {
+  char byte = 1;
+  ssize_t ignored = write(stopPipe[1], &byte, 1);
+  (void)ignored;
+}
+
+// Accepts every pending connection. Out of descriptors, it uses the spare
+// fd to accept and drop one, as the level-triggered listener would
+// otherwise spin; on other errors it returns false so the caller pauses
+// the listener.
+bool acceptConnections(int epfd, int listenFd, int &spareFd) {
+  while (true) {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      METRICS_INC(acceptErrorCount);
+      if ((errno == EMFILE || errno == ENFILE) && spareFd >= 0) {
+        close(spareFd);
+        fd = accept(listenFd, NULL, NULL);
+        if (fd >= 0) {
+          close(fd); // Shed the connection
+        }
+        spareFd = open("/dev/null", O_RDONLY);
+        cerr << "Out of file descriptors; dropped a connection\n";
+        if (fd >= 0 && spareFd >= 0) {
+          continue;
+        }
+      } else {
+        cerr << "accept failed: " << strerror(errno) << "\n";
+      }
+      return false;
+    }
+    setNonBlocking(fd);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    METRICS_INC(connectionCount);
+    Connection *c = new Connection;
+    c->fd = fd;
+    c->outPos = 0;
+    c->interest = EPOLLIN | EPOLLRDHUP;
+    c->closing = false;
+    epoll_event ev;
+    ev.events = c->interest;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+  }
+}
+
+void closeConnection(int epfd, Connection *conn) {
+  epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+  close(conn->fd);
+  delete conn;
+}
+
+int runServer(const string &endpoint) {
+  int listenFd = openListener(endpoint);
+  if (listenFd < 0) {
+    cerr << "Unable to listen on " << endpoint << ": " << strerror(errno)
+         << "\n";
+    return 1;
+  }
+  int epfd = epoll_create1(0);
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL; // NULL marks the listening socket
+  epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+
+  if (pipe(stopPipe) == 0) {
+    setNonBlocking(stopPipe[1]);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &stopMarker;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, stopPipe[0], &ev);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+  }
+
+  cerr << "Parking server listening on " << endpoint << "\n";
+  cout.setstate(ios::badbit); // Silence the interactive messages
+  deferWrites = true;
+
+  const int MAX_EVENTS = 64;
+  const int ACCEPT_BACKOFF_MS = 100;
+  epoll_event events[MAX_EVENTS];
+  char buf[16 * 1024];
+  bool running = true;
+  int status = 0;
+  int spareFd = open("/dev/null", O_RDONLY); // Reserve for EMFILE
+  bool listenerPaused = false;
+  chrono::steady_clock::time_point pausedAt;
+  while (running) {
+    if (listenerPaused &&
+        chrono::steady_clock::now() - pausedAt >=
+            chrono::milliseconds(ACCEPT_BACKOFF_MS)) {
+      epoll_event lev;
+      lev.events = EPOLLIN;
+      lev.data.ptr = NULL;
+      epoll_ctl(epfd, EPOLL_CTL_MOD, listenFd, &lev);
+      listenerPaused = false;
+    }
+    int n = epoll_wait(epfd, events, MAX_EVENTS,
+                       listenerPaused ? ACCEPT_BACKOFF_MS : -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      status = 1;
+      break;
+    }
+    for (int e = 0; e < n; ++e) {
+      if (events[e].data.ptr == &stopMarker) {
+        running = false;
+        continue;
+      }
+      Connection *conn = (Connection *)events[e].data.ptr;
+      if (conn == NULL) {
+        if (!acceptConnections(epfd, listenFd, spareFd)) {
+          epoll_event lev;
+          lev.events = 0; // Paused; re-armed after ACCEPT_BACKOFF_MS
+          lev.data.ptr = NULL;
+          epoll_ctl(epfd, EPOLL_CTL_MOD, listenFd, &lev);
+          listenerPaused = true;
+          pausedAt = chrono::steady_clock::now();
+        }
+        continue;
+      }
+
+      if (!conn->closing && pendingOutput(*conn) < OUT_HIGH_WATER &&
+          (events[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        size_t budget = READ_BUDGET; // Level-triggered: the rest waits
+        while (budget > 0) {
+          ssize_t got = recv(conn->fd, buf, min(sizeof(buf), budget), 0);
+          if (got > 0) {
+            conn->in.append(buf, got);
+            budget -= got;
+            continue;
+          }
+          if (got < 0 && errno == EINTR) {
+            continue;
+          }
+          if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            conn->closing = true; // Peer closed; still answer what it sent
+          }
+          break;
+        }
+      }
+      // Frames held back by the high-water mark run as the backlog drains
+      if (!processInput(*conn)) {
+        conn->closing = true;
+      }
+      if (!flushOutput(*conn)) {
+        closeConnection(epfd, conn);
+        continue;
+      }
+      if (!processInput(*conn)) {
+        conn->closing = true;
+      }
+      if (conn->closing && pendingOutput(*conn) == 0) {
+        closeConnection(epfd, conn);
+        continue;
+      }
+      updateInterest(epfd, *conn);
+    }
+  }
+  cerr << "Parking server shutting down\n";
+  flushPendingWrites();
+  close(epfd);
+  close(listenFd);
+  if (spareFd >= 0) {
+    close(spareFd);
+  }
+  if (endpoint.find_first_not_of("0123456789") != string::npos) {
+    unlink(endpoint.c_str()); // Remove our Unix socket
+  }
+  return status;
+}
+#else
+int runServer(const string &endpoint) {
+  cout << "Server mode is only available on Linux.\n";
+  return 1;
+}
+#endif